@@ -0,0 +1,256 @@
+#include "cardsink.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+extern char module[];
+
+CardSink::CardSink(std::string path) : path(std::move(path)) {}
+
+CardSink::~CardSink() {
+    close();
+}
+
+bool CardSink::open() {
+    close();
+    return map(false);
+}
+
+bool CardSink::publish(const cardInfoType& card) {
+    if (createOnPublish) {
+        createOnPublish = false;
+        map(true);
+    }
+
+    CardRecord rec{};
+    fillRecord(rec, card);
+    sequence += 2;
+    rec.sequence = sequence;
+
+    if (!record) {
+        return writeFallback(rec);
+    }
+
+    // Seqlock style: mark the record as in flight, rewrite the payload, then publish the new even sequence in one store
+    std::atomic_ref recordSequence(record->sequence);
+    recordSequence.store(sequence - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(record->accessCode, rec.accessCode, sizeof(rec.accessCode));
+    memcpy(record->uid, rec.uid, sizeof(rec.uid));
+    recordSequence.store(sequence, std::memory_order_release);
+    return true;
+}
+
+void CardSink::fillRecord(CardRecord& rec, const cardInfoType& card) {
+    memset(&rec, 0, sizeof(rec));
+
+    const size_t codeLen = card.accessCode.copy(rec.accessCode, sizeof(rec.accessCode) - 2);
+    rec.accessCode[codeLen] = '\n';
+    card.uid.copy(rec.uid, sizeof(rec.uid) - 1);
+}
+
+void CardSink::seedRecord(const char* data, const size_t len) {
+    CardRecord seeded{};
+    if (len == sizeof(CardRecord)) {
+        // Already a record, keep its UID and sequence
+        memcpy(&seeded, data, sizeof(CardRecord));
+        seeded.uid[sizeof(seeded.uid) - 1] = '\0';
+        seeded.sequence &= ~1u;
+        memset(seeded.accessCode, 0, sizeof(seeded.accessCode));
+    }
+
+    // The access code is the first line, both in records and in plain-text files from older versions
+    size_t codeLen = 0;
+    while (codeLen < len && codeLen < sizeof(seeded.accessCode) - 2 && data[codeLen] != '\n' && data[codeLen] != '\r' && data[codeLen] != '\0') {
+        codeLen++;
+    }
+    if (codeLen > 0) {
+        memcpy(seeded.accessCode, data, codeLen);
+        seeded.accessCode[codeLen] = '\n';
+    }
+
+    memcpy(record, &seeded, sizeof(CardRecord));
+    sequence = seeded.sequence;
+}
+
+#ifdef _WIN32
+bool CardSink::map(const bool create) {
+    hFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                        create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        if (!create && GetLastError() == ERROR_FILE_NOT_FOUND) {
+            // Nothing was handed off yet, leave the file missing until there is a card to put in it
+            createOnPublish = true;
+            return true;
+        }
+        printWarning("%s, %s: Failed to open %s: 0x%08X, falling back to rename\n", __func__, module, path.c_str(), GetLastError());
+        return false;
+    }
+
+    // Keep whatever card was handed off last, reading one byte more than a record to tell records from other contents
+    char existing[sizeof(CardRecord) + 1];
+    DWORD existingLen = 0;
+    if (!ReadFile(hFile, existing, sizeof(existing), &existingLen, nullptr)) {
+        existingLen = 0;
+    }
+
+    LARGE_INTEGER recordSize;
+    recordSize.QuadPart = sizeof(CardRecord);
+    if (!SetFilePointerEx(hFile, recordSize, nullptr, FILE_BEGIN) || !SetEndOfFile(hFile)) {
+        printWarning("%s, %s: Failed to size %s: 0x%08X, falling back to rename\n", __func__, module, path.c_str(), GetLastError());
+        close();
+        return false;
+    }
+
+    hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READWRITE, 0, sizeof(CardRecord), nullptr);
+    if (hMapping == nullptr) {
+        printWarning("%s, %s: Failed to map %s: 0x%08X, falling back to rename\n", __func__, module, path.c_str(), GetLastError());
+        close();
+        return false;
+    }
+
+    record = static_cast<CardRecord*>(MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, sizeof(CardRecord)));
+    if (record == nullptr) {
+        printWarning("%s, %s: Failed to map view of %s: 0x%08X, falling back to rename\n", __func__, module, path.c_str(), GetLastError());
+        close();
+        return false;
+    }
+
+    seedRecord(existing, existingLen);
+    return true;
+}
+
+void CardSink::close() {
+    createOnPublish = false;
+    if (record) {
+        FlushViewOfFile(record, sizeof(CardRecord));
+        UnmapViewOfFile(record);
+        record = nullptr;
+    }
+    if (hMapping) {
+        CloseHandle(hMapping);
+        hMapping = nullptr;
+    }
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+        hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+void CardSink::flush() {
+    if (record && !FlushViewOfFile(record, sizeof(CardRecord))) {
+        printError("%s, %s: Failed to flush %s: 0x%08X\n", __func__, module, path.c_str(), GetLastError());
+    }
+}
+
+bool CardSink::writeFallback(const CardRecord& rec) {
+    const std::string tmpPath = path + ".tmp";
+    const HANDLE hTmp = CreateFileA(tmpPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hTmp == INVALID_HANDLE_VALUE) {
+        printError("%s, %s: Failed to open %s: 0x%08X\n", __func__, module, tmpPath.c_str(), GetLastError());
+        return false;
+    }
+
+    DWORD written = 0;
+    const bool ok = WriteFile(hTmp, &rec, sizeof(rec), &written, nullptr) && written == sizeof(rec);
+    CloseHandle(hTmp);
+    if (!ok) {
+        printError("%s, %s: Failed to write %s: 0x%08X\n", __func__, module, tmpPath.c_str(), GetLastError());
+        DeleteFileA(tmpPath.c_str());
+        return false;
+    }
+
+    if (!MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        printError("%s, %s: Failed to replace %s: 0x%08X\n", __func__, module, path.c_str(), GetLastError());
+        DeleteFileA(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+#else
+bool CardSink::map(const bool create) {
+    fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd < 0) {
+        if (!create && errno == ENOENT) {
+            // Nothing was handed off yet, leave the file missing until there is a card to put in it
+            createOnPublish = true;
+            return true;
+        }
+        printWarning("%s, %s: Failed to open %s: %s, falling back to rename\n", __func__, module, path.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Keep whatever card was handed off last, reading one byte more than a record to tell records from other contents
+    char existing[sizeof(CardRecord) + 1];
+    const ssize_t readLen = pread(fd, existing, sizeof(existing), 0);
+    const size_t existingLen = readLen > 0 ? static_cast<size_t>(readLen) : 0;
+
+    if (ftruncate(fd, sizeof(CardRecord)) != 0) {
+        printWarning("%s, %s: Failed to size %s: %s, falling back to rename\n", __func__, module, path.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    void* view = mmap(nullptr, sizeof(CardRecord), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        printWarning("%s, %s: Failed to map %s: %s, falling back to rename\n", __func__, module, path.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    record = static_cast<CardRecord*>(view);
+    seedRecord(existing, existingLen);
+    return true;
+}
+
+void CardSink::close() {
+    createOnPublish = false;
+    if (record) {
+        msync(record, sizeof(CardRecord), MS_SYNC);
+        munmap(record, sizeof(CardRecord));
+        record = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void CardSink::flush() {
+    if (record && msync(record, sizeof(CardRecord), MS_ASYNC) != 0) {
+        printError("%s, %s: Failed to flush %s: %s\n", __func__, module, path.c_str(), strerror(errno));
+    }
+}
+
+bool CardSink::writeFallback(const CardRecord& rec) {
+    const std::string tmpPath = path + ".tmp";
+    const int tmpFd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tmpFd < 0) {
+        printError("%s, %s: Failed to open %s: %s\n", __func__, module, tmpPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    const bool ok = write(tmpFd, &rec, sizeof(rec)) == static_cast<ssize_t>(sizeof(rec));
+    ::close(tmpFd);
+    if (!ok) {
+        printError("%s, %s: Failed to write %s: %s\n", __func__, module, tmpPath.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        printError("%s, %s: Failed to replace %s: %s\n", __func__, module, path.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+#include <helpers.h>
+#include <platform.h>
+#include <cstddef>
+#include <string>
+
+// Fixed-size record kept in the hand-off file. The access code sits at offset 0 followed by a newline
+// so readers that treat the file as plain text still see the code on its first line.
+struct CardRecord {
+    char accessCode[22];            // Access code, newline and terminator.
+    char uid[18];                   // Card UID as hex and terminator.
+    u32 sequence;                   // Even when the record is stable, odd while it is being rewritten.
+};
+
+// Hosts read this layout straight from the file, it's documented in README.md
+static_assert(sizeof(CardRecord) == 44, "cards.dat record must stay 44 bytes");
+static_assert(offsetof(CardRecord, accessCode) == 0, "access code must sit at offset 0 of cards.dat");
+static_assert(offsetof(CardRecord, uid) == 22, "UID must sit at offset 22 of cards.dat");
+static_assert(offsetof(CardRecord, sequence) == 40, "sequence number must sit at offset 40 of cards.dat");
+
+class CardSink {
+public:
+    explicit CardSink(std::string path);
+    ~CardSink();
+
+    CardSink(const CardSink&) = delete;
+    CardSink& operator=(const CardSink&) = delete;
+
+    bool open();                    // Map the hand-off file if it exists, falls back to temp file + rename if mapping fails.
+    void close();                   // Unmap and close the hand-off file.
+    bool publish(const cardInfoType& card); // Publish a card to the hand-off file.
+    void flush();                   // Flush the mapped record to disk, publish() leaves this to the caller.
+
+private:
+    std::string path;               // Path of the hand-off file.
+#ifdef _WIN32
+    HANDLE hFile = INVALID_HANDLE_VALUE; // Handle to the hand-off file.
+    HANDLE hMapping = nullptr;      // Handle to the file mapping.
+#else
+    int fd = -1;                    // Descriptor of the hand-off file.
+#endif
+    CardRecord* record = nullptr;   // Mapped record, null when using the fallback.
+    u32 sequence = 0;               // Sequence number of the last published record.
+    bool createOnPublish = false;   // Whether the hand-off file didn't exist at open and is created by the first publish.
+
+    bool map(bool create);          // Open and map the hand-off file, creating it if asked to.
+    bool writeFallback(const CardRecord& rec); // Write the record to a temp file and rename it over the hand-off file.
+    static void fillRecord(CardRecord& rec, const cardInfoType& card); // Copy card info into a record.
+    void seedRecord(const char* data, size_t len); // Carry the previous contents of the hand-off file over into the mapped record.
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include <windows.h>
+#include "platform.h"
 
 constexpr u8 maxApduSize = 255;
 constexpr BYTE piccOperatingParams = 0xDFu;
@@ -1,31 +1,27 @@
 #include "scard.h"
+#include "cardsink.h"
 #include "helpers.h"
-#include <windows.h>
-#include <fstream>
+#include "platform.h"
+#include "scheduler.h"
 #include <thread>
 #include <sstream>
 #include <chrono>
 #include <atomic>
 
 char module[] = "scardreader";
+constexpr bool lowerReaderPriority = false; // Run the reader thread below normal priority on busy cabinets.
 
 std::thread readerThread;
 bool initialized = false;
 std::atomic stopFlag(false);
 SmartCard sCard;
-
-void pressKey(const WORD key) {
-    INPUT ip = {};
-    ip.type = INPUT_KEYBOARD;
-    ip.ki.wVk = key;
-    SendInput(1, &ip, sizeof(INPUT));
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    ip.ki.dwFlags = KEYEVENTF_KEYUP;
-    SendInput(1, &ip, sizeof(INPUT));
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-}
+CardSink cardSink("cards.dat");
 
 void readerPollThread() {
+    if (lowerReaderPriority) {
+        lowerThreadPriority();
+    }
+
     while (!stopFlag.load()) {
         if (stopFlag.load()) {
             break;
@@ -53,13 +49,11 @@ void readerPollThread() {
         printInfo("Card UID: %s\n", sCard.cardInfo.uid.c_str());
         printInfo("Access Code: %s\n", sCard.cardInfo.accessCode.c_str());
 
-        // Write access code to file
-        if (std::ofstream fp("cards.dat"); fp.is_open()) {
-            fp << sCard.cardInfo.accessCode;
-            fp.close();
-        } else {
-            printError("%s, %s: Failed to open cards.dat\n", __func__, module);
+        // Hand the access code off to the game
+        if (!cardSink.publish(sCard.cardInfo)) {
+            printError("%s, %s: Failed to write cards.dat\n", __func__, module);
         }
+        scheduler.defer([] { cardSink.flush(); });
         
         // Press F3 key
         pressKey(0x72);
@@ -70,8 +64,14 @@ void readerPollThread() {
 }
 
 extern "C" {
-__declspec(dllexport) void Init() {
+PLUGIN_EXPORT void Init() {
+    scheduler.start();
+
     if (!initialized) {
+        if (!KEY_INJECTION_SUPPORTED) {
+            printWarning("%s, %s: Card insertion is not triggered on this platform, the host has to watch cards.dat and insert the card itself\n", __func__, module);
+        }
+
         sCard = SmartCard();
 
         initialized = true;
@@ -84,22 +84,31 @@ __declspec(dllexport) void Init() {
         printInfo("%s, %s: SmartCardReader initialized\n", __func__, module);
     }
 
+    cardSink.open();
+
     stopFlag.store(false);
     readerThread = std::thread(readerPollThread);
 }
 
 
 
-__declspec(dllexport) void Exit() {
+PLUGIN_EXPORT void Exit() {
     printInfo("%s, %s: Exiting SmartCardReader\n", __func__, module);
     stopFlag.store(true);
     if (readerThread.joinable()) {
         readerThread.join();
     }
 
+    scheduler.stop();
+    cardSink.close();
+
     if (initialized) {
         sCard.~SmartCard();
         initialized = false;
     }
 }
+
+PLUGIN_EXPORT void Update() {
+    scheduler.onFrame();
+}
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include "helpers.h"
 #include "constants.h"
+#include "platform.h"
+#include "scheduler.h"
 
-#include <windows.h>
+#include <cstdarg>
+#include <cstdio>
 
 
-void *consoleHandle = nullptr;
 constexpr int nTables = 8;
 constexpr int iterAdd = 5;
 
@@ -13,11 +15,25 @@ printColour (const int colour, const char *format, ...) {
 	va_list args;
 	va_start (args, format);
 
-	if (consoleHandle == nullptr) consoleHandle = GetStdHandle (STD_OUTPUT_HANDLE);
+	if (scheduler.active ()) {
+		// Format now, write to the console in the slack after the next frame
+		va_list sizeArgs;
+		va_copy (sizeArgs, args);
+		const int len = vsnprintf (nullptr, 0, format, sizeArgs);
+		va_end (sizeArgs);
 
-	SetConsoleTextAttribute (consoleHandle, colour);
-	vprintf (format, args);
-	SetConsoleTextAttribute (consoleHandle, FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED);
+		std::string message (len > 0 ? len : 0, '\0');
+		vsnprintf (message.data (), message.size () + 1, format, args);
+		scheduler.defer ([colour, message = std::move (message)] {
+			setConsoleColour (colour);
+			fputs (message.c_str (), stdout);
+			setConsoleColour (DEFAULT_COLOUR);
+		});
+	} else {
+		setConsoleColour (colour);
+		vprintf (format, args);
+		setConsoleColour (DEFAULT_COLOUR);
+	}
 
 	va_end (args);
 }
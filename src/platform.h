@@ -0,0 +1,34 @@
+#pragma once
+#include <helpers.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // Keep windows.h from defining min/max macros over std::min/std::max
+#endif
+#include <windows.h>
+#include <winscard.h>
+
+#define PLUGIN_EXPORT           __declspec(dllexport)
+#define READER_ESCAPE_CODE      SCARD_CTL_CODE(3500)
+#define READER_ESCAPE_REQUIRED  1 // The ACS driver always accepts escape commands
+#define KEY_INJECTION_SUPPORTED 1
+#else
+#include <winscard.h>
+#include <reader.h>
+
+#define PLUGIN_EXPORT           __attribute__((visibility("default")))
+#define READER_ESCAPE_CODE      SCARD_CTL_CODE(1) // IOCTL_SMARTCARD_VENDOR_IFD_EXCHANGE of libccid
+#define READER_ESCAPE_REQUIRED  0 // libccid rejects it unless DRIVER_OPTION_CCID_EXCHANGE_AUTHORIZED is set in its Info.plist
+#define KEY_INJECTION_SUPPORTED 0
+
+#define FOREGROUND_BLUE  0x0001
+#define FOREGROUND_GREEN 0x0002
+#define FOREGROUND_RED   0x0004
+#endif
+
+#define DEFAULT_COLOUR (FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED)
+
+void sleepMs (u32 ms);
+void setConsoleColour (int colour);
+void pressKey (u16 key);
+void lowerThreadPriority ();
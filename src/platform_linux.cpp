@@ -0,0 +1,34 @@
+#include "platform.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <sys/resource.h>
+#include <unistd.h>
+
+void
+sleepMs (const u32 ms) {
+	std::this_thread::sleep_for (std::chrono::milliseconds (ms));
+}
+
+void
+setConsoleColour (const int colour) {
+	if (colour == DEFAULT_COLOUR) {
+		fputs ("\033[0m", stdout);
+		return;
+	}
+
+	// Windows console attributes are BGR bits, ANSI colours are RGB bits
+	const int ansi = 30 + ((colour & FOREGROUND_RED) ? 1 : 0) + ((colour & FOREGROUND_GREEN) ? 2 : 0) + ((colour & FOREGROUND_BLUE) ? 4 : 0);
+	printf ("\033[%dm", ansi);
+}
+
+void
+pressKey (u16) {
+	// No game window to send keys to natively, Init() warns that card insertion is left to the host
+}
+
+void
+lowerThreadPriority () {
+	// Linux nice values are per thread when addressed by tid
+	setpriority (PRIO_PROCESS, gettid (), 5);
+}
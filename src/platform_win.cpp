@@ -0,0 +1,33 @@
+#include "platform.h"
+#include <chrono>
+#include <thread>
+
+void *consoleHandle = nullptr;
+
+void
+sleepMs (const u32 ms) {
+	Sleep (ms);
+}
+
+void
+setConsoleColour (const int colour) {
+	if (consoleHandle == nullptr) consoleHandle = GetStdHandle (STD_OUTPUT_HANDLE);
+	SetConsoleTextAttribute (consoleHandle, colour);
+}
+
+void
+pressKey (const u16 key) {
+	INPUT ip  = {};
+	ip.type   = INPUT_KEYBOARD;
+	ip.ki.wVk = key;
+	SendInput (1, &ip, sizeof (INPUT));
+	std::this_thread::sleep_for (std::chrono::milliseconds (100));
+	ip.ki.dwFlags = KEYEVENTF_KEYUP;
+	SendInput (1, &ip, sizeof (INPUT));
+	std::this_thread::sleep_for (std::chrono::milliseconds (100));
+}
+
+void
+lowerThreadPriority () {
+	SetThreadPriority (GetCurrentThread (), THREAD_PRIORITY_BELOW_NORMAL);
+}
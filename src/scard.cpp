@@ -1,5 +1,7 @@
 #include "scard.h"
 #include "constants.h"
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 
@@ -13,10 +15,7 @@ SmartCard::~SmartCard() {
     if (hCard && connected) {
         disconnect();
     }
-    if (readerName) {
-        SCardFreeMemory(hContext, readerName);
-    }
-    SCardReleaseContext(hContext);
+    releaseContext();
 }
 
 bool SmartCard::initialize() {
@@ -27,6 +26,57 @@ bool SmartCard::initialize() {
     return setupReader();
 }
 
+bool SmartCard::reinitialize() {
+    disconnect();
+    releaseContext();
+    return initialize();
+}
+
+bool SmartCard::recoverContext() {
+    if (recoveryDelay > 0) {
+        sleepMs(recoveryDelay);
+    }
+
+    if (reinitialize()) {
+        if (recoveryDelay > 0) {
+            printInfo("%s, %s: Context reestablished\n", __func__, module);
+        }
+        recoveryDelay = 0;
+        return true;
+    }
+
+    recoveryDelay = recoveryDelay == 0 ? minRecoveryDelay : std::min(recoveryDelay * 2, maxRecoveryDelay);
+    printError("%s, %s: Failed to reestablish context, retrying in %d ms\n", __func__, module, recoveryDelay);
+    return false;
+}
+
+bool SmartCard::needsRecovery(const long lRet) {
+    switch (lRet) {
+        case SCARD_E_SERVICE_STOPPED:
+        case SCARD_E_NO_SERVICE:
+        case SCARD_E_NO_READERS_AVAILABLE:
+        case SCARD_E_INVALID_HANDLE:
+        case SCARD_E_INVALID_VALUE:
+        case SCARD_E_UNKNOWN_READER:
+        case SCARD_E_READER_UNAVAILABLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void SmartCard::releaseContext() {
+    readerState[0].szReader = nullptr;
+    if (readerName) {
+        SCardFreeMemory(hContext, readerName);
+        readerName = nullptr;
+    }
+    if (hContext) {
+        SCardReleaseContext(hContext);
+        hContext = 0;
+    }
+}
+
 bool SmartCard::connect() {
     int retryCount = 0;
     constexpr int maxRetries = 100;
@@ -50,7 +100,7 @@ bool SmartCard::connect() {
             }
         }
         retryCount++;
-        Sleep(retryDelay);
+        sleepMs(retryDelay);
     }
     printError("%s, %s: Failed to connect to reader: 0x%08X\n", __func__, module, lRet);
     return false;
@@ -65,25 +115,22 @@ void SmartCard::disconnect() {
 }
 
 bool SmartCard::isCardPresent() {
-    int retryCount = 0;
+    if (!hContext || !readerName) {
+        recoverContext();
+        return false;
+    }
 
     readerState[0].dwCurrentState = SCARD_STATE_EMPTY;
-    long lRet = SCardGetStatusChange(hContext, 0, readerState, 1);
-    while (lRet == SCARD_E_SERVICE_STOPPED || lRet == SCARD_E_NO_SERVICE || lRet == SCARD_E_NO_READERS_AVAILABLE) {
-        constexpr int retryDelay = 10;
-        printWarning("%s, %s: Service stopped, no service or no readers available, attempting to reestablish context\n", __func__, module);
-        if (!initialize()) {
-            printError("%s, %s: Failed to reestablish context: 0x%08X\n", __func__, module, lRet);
-            return false;
-        }
+    const long lRet = SCardGetStatusChange(hContext, 0, readerState, 1);
+    if (needsRecovery(lRet)) {
+        printWarning("%s, %s: Service stopped or reader lost: 0x%08X, attempting to reestablish context\n", __func__, module, lRet);
+        recoverContext();
+        return false;
+    }
 
-        lRet = SCardGetStatusChange(hContext, 0, readerState, 1);
-        retryCount++;
-        if (constexpr int maxRetries = 100; retryCount >= maxRetries) {
-            printError("%s, %s: Failed to get status change: 0x%08X\n", __func__, module, lRet);
-            return false;
-        }
-        Sleep(retryDelay);
+    // Still empty
+    if (lRet == SCARD_E_TIMEOUT) {
+        return false;
     }
 
     if (lRet != SCARD_S_SUCCESS) {
@@ -95,34 +142,35 @@ bool SmartCard::isCardPresent() {
 }
 
 void SmartCard::update() {
-    int retryCount = 0;
-
     // Reset card info
     cardInfo.uid = "";
     cardInfo.accessCode = "";
     cardInfo.cardType = "empty";
 
-    long lRet = SCardGetStatusChange(hContext, readCooldown, readerState, 1);
-    if (lRet == SCARD_E_TIMEOUT) return;
-    while (lRet == SCARD_E_SERVICE_STOPPED || lRet == SCARD_E_NO_SERVICE || lRet == SCARD_E_NO_READERS_AVAILABLE) {
-        constexpr int retryDelay = 10;
-        printWarning("%s, %s: Service stopped, no service or no readers available, attempting to reestablish context\n", __func__, module);
-        if (!initialize()) {
-            printError("%s, %s: Failed to reestablish context: 0x%08X\n", __func__, module, lRet);
-            return;
-        }
+    // A failed recovery leaves no context or no reader, keep trying with backoff
+    if (!hContext || !readerName) {
+        recoverContext();
+        return;
+    }
 
-        lRet = SCardGetStatusChange(hContext, readCooldown, readerState, 1);
-        retryCount++;
-        if (constexpr int maxRetries = 100; retryCount >= maxRetries) {
-            printError("%s, %s: Failed to get status change: 0x%08X\n", __func__, module, lRet);
-            return;
-        }
-        Sleep(retryDelay);
+    const long lRet = SCardGetStatusChange(hContext, readCooldown, readerState, 1);
+    if (lRet == SCARD_E_TIMEOUT) return;
+    if (needsRecovery(lRet)) {
+        printWarning("%s, %s: Service stopped or reader lost: 0x%08X, attempting to reestablish context\n", __func__, module, lRet);
+        recoverContext();
+        return;
     }
 
     if (lRet != SCARD_S_SUCCESS) {
         printError("%s, %s: Failed to get status change: 0x%08X\n", __func__, module, lRet);
+        sleepMs(readCooldown);
+        return;
+    }
+
+    // pcsc-lite reports a reader that went away as unknown rather than failing the wait
+    if (readerState[0].dwEventState & SCARD_STATE_UNKNOWN) {
+        printWarning("%s, %s: Reader lost, attempting to reestablish context\n", __func__, module);
+        recoverContext();
         return;
     }
 
@@ -337,9 +385,9 @@ bool SmartCard::checkAICAccessCode(const std::string& accessCode) {
 }
 
 bool SmartCard::readATR() {
-    byte atr[32];
+    BYTE atr[32];
     DWORD atrLen = sizeof(atr);
-    TCHAR szReader[200];
+    char szReader[200];
     DWORD cchReader = 200;
     if (const long lRet = SCardStatus(hCard, szReader, &cchReader, nullptr, nullptr, atr, &atrLen); lRet != SCARD_S_SUCCESS) {
         printError("%s, %s: Failed to read ATR: 0x%08X\n", __func__, module, lRet);
@@ -354,7 +402,7 @@ void SmartCard::handleCardStatusChange() {
     const bool wasCardPresent = (readerState[0].dwCurrentState & SCARD_STATE_PRESENT) > 0;
     if (newState & SCARD_STATE_UNAVAILABLE) {
         printError("Card reader unavailable\n");
-        Sleep(readCooldown);
+        sleepMs(readCooldown);
     } else if (newState & SCARD_STATE_EMPTY) {
         printWarning("No card in reader\n");
     } else if (newState & SCARD_STATE_PRESENT && !wasCardPresent) {
@@ -363,7 +411,7 @@ void SmartCard::handleCardStatusChange() {
     }
     readerState[0].dwCurrentState = readerState[0].dwEventState;
 
-    Sleep(readCooldown);
+    sleepMs(readCooldown);
 }
 
 bool SmartCard::setupReader() {
@@ -390,9 +438,15 @@ bool SmartCard::setupReader() {
     }
 
     if (!sendPiccOperatingParams()) {
-        return false;
+        if (READER_ESCAPE_REQUIRED) {
+            return false;
+        }
+        printWarning("%s, %s: Continuing with the reader's default PICC operating parameters\n", __func__, module);
     }
 
+    memset(&readerState[0], 0, sizeof(SCARD_READERSTATE));
+    readerState[0].szReader = readerName;
+
     return true;
 }
 
@@ -405,7 +459,7 @@ bool SmartCard::sendPiccOperatingParams() {
 
     DWORD cbRecv = maxApduSize;
     BYTE pbRecv[maxApduSize];
-    lRet = SCardControl(hCard, SCARD_CTL_CODE(3500), piccOperatingParamCmd, sizeof(piccOperatingParamCmd), pbRecv, cbRecv, &cbRecv);
+    lRet = SCardControl(hCard, READER_ESCAPE_CODE, piccOperatingParamCmd, sizeof(piccOperatingParamCmd), pbRecv, cbRecv, &cbRecv);
     if (lRet != SCARD_S_SUCCESS) {
         printError("%s, %s: Failed to send PICC operating parameters: 0x%08X\n", __func__, module, lRet);
         disconnect();
@@ -414,8 +468,6 @@ bool SmartCard::sendPiccOperatingParams() {
     printInfo("%s, %s: PICC operating parameters set\n", __func__, module);
 
     disconnect();
-    memset(&readerState[0], 0, sizeof(SCARD_READERSTATE));
-    readerState[0].szReader = readerName;
 
     return true;
 }
@@ -444,7 +496,7 @@ long SmartCard::transmit(LPCSCARD_IO_REQUEST pci, const BYTE* cmd, size_t cmdLen
         }
 
         retryCount++;
-        Sleep(readCooldown);
+        sleepMs(readCooldown);
     }
 
     printError("%s, %s: Failed to transmit: 0x%08X\n", __func__, module, lRet);
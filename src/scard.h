@@ -1,8 +1,9 @@
 #pragma once
 #include <cstdint>
-#include <winscard.h>
+#include <platform.h>
 #include <helpers.h>
 #include <string>
+#include <vector>
 
 class SmartCard {
 public:
@@ -12,6 +13,7 @@ public:
     ~SmartCard();
 
     bool initialize();             // Initialize the smart card reader context.
+    bool reinitialize();           // Release the current context and initialize a new one.
     void update();    // Update the status of the smart card reader.
 
 private:
@@ -22,6 +24,9 @@ private:
     DWORD activeProtocol{};           // Active protocol used in communication.
     BYTE cardProtocol{};                // Protocol used by the card.
     int readCooldown = 500;               // Cooldown for reading the card.
+    int recoveryDelay = 0;          // Backoff before the next context recovery attempt, 0 when healthy.
+    static constexpr int minRecoveryDelay = 50;    // First backoff after a failed recovery.
+    static constexpr int maxRecoveryDelay = 2000;  // Backoff cap between recovery attempts.
     bool connected = false;         // Whether the card is connected.
 
     void handleCardStatusChange();                 // Handle changes in card status.
@@ -34,6 +39,9 @@ private:
 	bool readATR();                                               // Read the ATR of the card.
     bool connect(); // Connect to a specific reader.
     void disconnect();             // Disconnect from the smart card reader.
+    void releaseContext();         // Release the reader name and the smart card context.
+    bool recoverContext();         // Reinitialize after the service or reader went away, backing off between failures.
+    static bool needsRecovery(long lRet); // Whether an error means the context or reader has to be reestablished.
     long connectReader(DWORD shareMode, DWORD preferredProtocols); // Connect to a specific reader.
     long transmit(LPCSCARD_IO_REQUEST pci, const BYTE* cmd, size_t cmdLen, BYTE* recv, DWORD* recvLen); // Transmit data to the card.
     static size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* userp); // Helper function to handle the response data.
@@ -0,0 +1,144 @@
+#include "scheduler.h"
+#include "platform.h"
+#include <cstdio>
+#include <algorithm>
+
+FrameScheduler scheduler;
+
+constexpr auto idleTimeout = std::chrono::milliseconds(100);        // Drain anyway if no frame ended for this long.
+constexpr auto minSlack = std::chrono::microseconds(500);           // Lower bound of the per-frame budget.
+constexpr auto maxSlack = std::chrono::microseconds(4000);          // Upper bound of the per-frame budget.
+constexpr f64 maxFrameInterval = 250000.0;                          // Frames longer than this (loading, stalls) are not learned.
+constexpr f64 slackFraction = 0.25;                                 // Share of a frame the worker may spend after it.
+constexpr size_t maxPendingTasks = 256;                             // Queue bound, keeps error storms from growing it without limit.
+
+void FrameScheduler::start() {
+    if (running.load()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = false;
+        framePending = false;
+    }
+    running.store(true, std::memory_order_release);
+    worker = std::thread(&FrameScheduler::run, this);
+}
+
+void FrameScheduler::stop() {
+    if (!running.load()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void FrameScheduler::onFrame() {
+    const auto now = clock::now();
+    bool hasWork;
+    {
+        std::lock_guard lock(mutex);
+        if (frameCount > 0) {
+            const f64 dt = std::chrono::duration<f64, std::micro>(now - lastFrame).count();
+            if (dt < maxFrameInterval) {
+                frameInterval = frameInterval == 0.0 ? dt : frameInterval * 0.9 + dt * 0.1;
+            }
+        }
+        lastFrame = now;
+        frameCount++;
+        hasWork = !tasks.empty();
+        // Only a frame that ends with work queued may wake the worker, a stale flag would let later work run mid-frame
+        framePending = hasWork;
+    }
+    if (hasWork) {
+        cv.notify_one();
+    }
+}
+
+void FrameScheduler::defer(std::function<void()> task) {
+    {
+        std::lock_guard lock(mutex);
+        if (running.load(std::memory_order_acquire)) {
+            if (tasks.size() < maxPendingTasks) {
+                tasks.push_back(std::move(task));
+            } else {
+                dropped++;
+            }
+            return;
+        }
+    }
+    task();
+}
+
+FrameScheduler::clock::duration FrameScheduler::slackBudget() const {
+    if (frameInterval == 0.0) {
+        return maxSlack;
+    }
+    const auto budget = std::chrono::duration_cast<clock::duration>(std::chrono::duration<f64, std::micro>(frameInterval * slackFraction));
+    return std::clamp<clock::duration>(budget, minSlack, maxSlack);
+}
+
+void FrameScheduler::queueDropReport() {
+    if (dropped == 0) {
+        return;
+    }
+
+    // Report in place of the dropped work, the queue has room again once the current batch runs
+    tasks.emplace_back([count = dropped] {
+        setConsoleColour(WARNING_COLOUR);
+        printf("Dropped %u deferred tasks, the queue was full\n", count);
+        setConsoleColour(DEFAULT_COLOUR);
+    });
+    dropped = 0;
+}
+
+void FrameScheduler::run() {
+    lowerThreadPriority();
+
+    std::unique_lock lock(mutex);
+    while (!stopping) {
+        const bool woken = cv.wait_for(lock, idleTimeout, [this] { return stopping || (framePending && !tasks.empty()); });
+        if (stopping) {
+            break;
+        }
+        // The wait timed out, only drain if frames stopped coming, otherwise keep waiting for the end of one
+        if (!woken && (tasks.empty() || (frameCount > 0 && clock::now() - lastFrame < idleTimeout))) {
+            continue;
+        }
+        framePending = false;
+
+        queueDropReport();
+
+        // Run as much as fits in the slack after the frame, the rest waits for the next one
+        const auto deadline = clock::now() + slackBudget();
+        while (!tasks.empty()) {
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+            if (clock::now() >= deadline) {
+                break;
+            }
+        }
+    }
+
+    // Stop accepting work before the final drain so nothing is left behind
+    running.store(false, std::memory_order_release);
+    queueDropReport();
+    while (!tasks.empty()) {
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
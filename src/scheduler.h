@@ -0,0 +1,41 @@
+#pragma once
+#include <helpers.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs non-urgent work (console output, file flushes) in the slack right after each game frame.
+// The frame cadence is learned from Update() calls; when they stop for a while work is drained on a timeout.
+class FrameScheduler {
+public:
+    void start();                   // Start the worker thread.
+    void stop();                    // Drain pending work and stop the worker thread.
+    void onFrame();                 // Mark the end of a frame, called from Update().
+    void defer(std::function<void()> task); // Queue work to run after the next frame, dropped if the queue is full.
+    bool active() const { return running.load(std::memory_order_acquire); }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::thread worker;             // Thread running the deferred work.
+    std::mutex mutex;               // Guards everything below.
+    std::condition_variable cv;     // Signalled on frames that end with work pending and on stop.
+    std::deque<std::function<void()>> tasks; // Pending deferred work, bounded by maxPendingTasks.
+    u32 dropped = 0;                // Work dropped because the queue was full since the last report.
+    clock::time_point lastFrame{};  // Time of the last Update() call.
+    f64 frameInterval = 0.0;        // Smoothed frame interval in microseconds, 0 until learned.
+    u64 frameCount = 0;             // Number of frames seen.
+    bool framePending = false;      // Whether the last frame ended with work queued and the worker hasn't run since.
+    bool stopping = false;          // Whether stop() was requested.
+    std::atomic<bool> running{false}; // Whether deferred work is accepted.
+
+    void run();                     // Worker loop.
+    void queueDropReport();         // Queue a warning about dropped work, called with the mutex held.
+    clock::duration slackBudget() const; // Time the worker may spend after a frame.
+};
+
+extern FrameScheduler scheduler;
@@ -0,0 +1,4 @@
+#pragma once
+// Subset of pcsc-lite's reader.h used by the reader.
+
+#define SCARD_CTL_CODE(code) (0x42000000 + (code))
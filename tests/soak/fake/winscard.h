@@ -0,0 +1,85 @@
+#pragma once
+// Subset of pcsc-lite's winscard.h used by the reader, implemented by fake_pcsc.cpp for the soak harness.
+#include <cstdint>
+
+typedef unsigned char BYTE;
+typedef unsigned long DWORD;
+typedef long LONG;
+typedef DWORD* LPDWORD;
+typedef BYTE* LPBYTE;
+typedef const BYTE* LPCBYTE;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef char* LPSTR;
+typedef const char* LPCSTR;
+typedef char* LPTSTR;
+typedef const char* LPCTSTR;
+typedef LONG SCARDCONTEXT;
+typedef LONG SCARDHANDLE;
+
+typedef struct {
+    const char* szReader;
+    void* pvUserData;
+    DWORD dwCurrentState;
+    DWORD dwEventState;
+    DWORD cbAtr;
+    unsigned char rgbAtr[33];
+} SCARD_READERSTATE, *LPSCARD_READERSTATE;
+
+typedef struct {
+    unsigned long dwProtocol;
+    unsigned long cbPciLength;
+} SCARD_IO_REQUEST, *PSCARD_IO_REQUEST, *LPSCARD_IO_REQUEST;
+typedef const SCARD_IO_REQUEST* LPCSCARD_IO_REQUEST;
+
+extern const SCARD_IO_REQUEST g_rgSCardT0Pci, g_rgSCardT1Pci;
+#define SCARD_PCI_T0 (&g_rgSCardT0Pci)
+#define SCARD_PCI_T1 (&g_rgSCardT1Pci)
+
+#define SCARD_S_SUCCESS              ((LONG)0x00000000)
+#define SCARD_E_INVALID_HANDLE       ((LONG)0x80100003)
+#define SCARD_E_NO_MEMORY            ((LONG)0x80100006)
+#define SCARD_E_INSUFFICIENT_BUFFER  ((LONG)0x80100008)
+#define SCARD_E_UNKNOWN_READER       ((LONG)0x80100009)
+#define SCARD_E_TIMEOUT              ((LONG)0x8010000A)
+#define SCARD_E_NO_SMARTCARD         ((LONG)0x8010000C)
+#define SCARD_E_INVALID_VALUE        ((LONG)0x80100011)
+#define SCARD_E_READER_UNAVAILABLE   ((LONG)0x80100017)
+#define SCARD_E_NO_SERVICE           ((LONG)0x8010001D)
+#define SCARD_E_SERVICE_STOPPED      ((LONG)0x8010001E)
+#define SCARD_E_NO_READERS_AVAILABLE ((LONG)0x8010002E)
+#define SCARD_W_RESET_CARD           ((LONG)0x80100068)
+#define SCARD_W_REMOVED_CARD         ((LONG)0x80100069)
+
+#define SCARD_AUTOALLOCATE (DWORD)(-1)
+#define SCARD_SCOPE_USER   0x0000
+
+#define SCARD_PROTOCOL_T0 0x0001
+#define SCARD_PROTOCOL_T1 0x0002
+
+#define SCARD_SHARE_EXCLUSIVE 0x0001
+#define SCARD_SHARE_SHARED    0x0002
+#define SCARD_SHARE_DIRECT    0x0003
+
+#define SCARD_LEAVE_CARD 0x0000
+#define SCARD_RESET_CARD 0x0001
+
+#define SCARD_STATE_UNAWARE     0x0000
+#define SCARD_STATE_IGNORE      0x0001
+#define SCARD_STATE_CHANGED     0x0002
+#define SCARD_STATE_UNKNOWN     0x0004
+#define SCARD_STATE_UNAVAILABLE 0x0008
+#define SCARD_STATE_EMPTY       0x0010
+#define SCARD_STATE_PRESENT     0x0020
+
+LONG SCardEstablishContext(DWORD dwScope, LPCVOID pvReserved1, LPCVOID pvReserved2, SCARDCONTEXT* phContext);
+LONG SCardReleaseContext(SCARDCONTEXT hContext);
+LONG SCardListReaders(SCARDCONTEXT hContext, LPCSTR mszGroups, LPSTR mszReaders, LPDWORD pcchReaders);
+LONG SCardFreeMemory(SCARDCONTEXT hContext, LPCVOID pvMem);
+LONG SCardGetStatusChange(SCARDCONTEXT hContext, DWORD dwTimeout, SCARD_READERSTATE* rgReaderStates, DWORD cReaders);
+LONG SCardConnect(SCARDCONTEXT hContext, LPCSTR szReader, DWORD dwShareMode, DWORD dwPreferredProtocols, SCARDHANDLE* phCard, LPDWORD pdwActiveProtocol);
+LONG SCardDisconnect(SCARDHANDLE hCard, DWORD dwDisposition);
+LONG SCardStatus(SCARDHANDLE hCard, LPSTR szReaderName, LPDWORD pcchReaderLen, LPDWORD pdwState, LPDWORD pdwProtocol, LPBYTE pbAtr, LPDWORD pcbAtrLen);
+LONG SCardTransmit(SCARDHANDLE hCard, LPCSCARD_IO_REQUEST pioSendPci, LPCBYTE pbSendBuffer, DWORD cbSendLength, LPSCARD_IO_REQUEST pioRecvPci, LPBYTE pbRecvBuffer,
+                   LPDWORD pcbRecvLength);
+LONG SCardControl(SCARDHANDLE hCard, DWORD dwControlCode, LPCVOID pbSendBuffer, DWORD cbSendLength, LPVOID pbRecvBuffer, DWORD cbRecvLength, LPDWORD lpBytesReturned);
@@ -0,0 +1,498 @@
+#include "fake_pcsc.h"
+#include <winscard.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+const SCARD_IO_REQUEST g_rgSCardT0Pci = {SCARD_PROTOCOL_T0, sizeof(SCARD_IO_REQUEST)};
+const SCARD_IO_REQUEST g_rgSCardT1Pci = {SCARD_PROTOCOL_T1, sizeof(SCARD_IO_REQUEST)};
+
+namespace fake {
+namespace {
+
+constexpr u64 callCost = 100;       // Virtual time spent in every SCard call.
+constexpr u64 never = std::numeric_limits<u64>::max();
+constexpr char readerName[] = "ACS ACR122U PICC Interface 00 00";
+constexpr BYTE mifareAtr[] = {0x3B, 0x8F, 0x80, 0x01, 0x80, 0x4F, 0x0C, 0xA0, 0x00, 0x00, 0x03, 0x06, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x6A};
+constexpr BYTE uid[] = {0x04, 0x6B, 0x2A, 0x91};
+
+enum class EventKind { CardOn, CardOff, ServiceDown, ServiceUp, ReaderOut, ReaderIn, ArmServiceRestart, ArmUnplug };
+
+struct Event {
+    EventKind kind;
+    u64 param = 0;                  // Tap index, call countdown or wait offset.
+    u64 duration = 0;               // Outage length of armed faults.
+};
+
+struct CardHandle {
+    u32 epoch;                      // Service epoch the handle was opened in.
+    u32 insertion;                  // Card insertion the handle is connected to.
+    bool direct;                    // Connected to the reader rather than the card.
+    bool reset = false;             // The card was reset under this handle.
+};
+
+struct World {
+    u64 now = 0;
+    std::multimap<u64, Event> events;
+    std::vector<Tap> taps;
+    Stats stats;
+
+    bool serviceUp = true;          // Cleared while an injected service restart is in progress.
+    u32 epoch = 1;                  // Bumped on every service stop, older handles go stale.
+    bool readerPresent = true;
+    bool windowsRemoval = false;    // Stop the service with the last reader like Windows 8 and later do.
+    int cardTap = -1;               // Tap whose card is on the reader, -1 when empty.
+    u32 insertion = 0;              // Bumped on every card insertion.
+    u64 recoveringSince = never;    // End of the last outage until the reader is healthy again.
+
+    std::unordered_map<SCARDCONTEXT, u32> contexts;
+    std::unordered_map<SCARDHANDLE, CardHandle> cards;
+    std::set<void*> readerLists;
+    LONG nextHandle = 1;
+
+    bool pullArmed = false;
+    bool resetArmed = false;
+    u64 restartCountdown = 0;
+    u64 restartDowntime = 0;
+    bool unplugArmed = false;
+    u64 unplugOffset = 0;
+    u64 unplugOutage = 0;
+};
+
+World world;
+
+bool serviceAvailable() {
+    return world.serviceUp && (world.readerPresent || !world.windowsRemoval);
+}
+
+bool degraded() {
+    return !serviceAvailable() || !world.readerPresent || world.recoveringSince != never;
+}
+
+void faultCard() {
+    if (world.cardTap >= 0) {
+        world.taps[world.cardTap].faulted = true;
+    }
+}
+
+void outageEnded() {
+    if (serviceAvailable() && world.readerPresent && world.recoveringSince == never) {
+        world.recoveringSince = world.now;
+    }
+}
+
+void apply(const Event& event) {
+    switch (event.kind) {
+        case EventKind::CardOn:
+            world.cardTap = static_cast<int>(event.param);
+            world.insertion++;
+            world.pullArmed = world.taps[event.param].pullDuringAuth;
+            world.resetArmed = world.taps[event.param].resetDuringTransmit;
+            if (degraded()) {
+                faultCard();
+            }
+            break;
+        case EventKind::CardOff:
+            if (world.cardTap == static_cast<int>(event.param)) {
+                world.cardTap = -1;
+                world.pullArmed = false;
+                world.resetArmed = false;
+            }
+            break;
+        case EventKind::ServiceDown:
+            if (serviceAvailable()) {
+                world.epoch++;
+            }
+            world.serviceUp = false;
+            world.recoveringSince = never;
+            faultCard();
+            break;
+        case EventKind::ServiceUp:
+            world.serviceUp = true;
+            outageEnded();
+            break;
+        case EventKind::ReaderOut:
+            if (world.windowsRemoval && serviceAvailable()) {
+                world.epoch++;
+            }
+            world.readerPresent = false;
+            world.recoveringSince = never;
+            faultCard();
+            break;
+        case EventKind::ReaderIn:
+            world.readerPresent = true;
+            outageEnded();
+            break;
+        case EventKind::ArmServiceRestart:
+            world.restartCountdown = event.param;
+            world.restartDowntime = event.duration;
+            break;
+        case EventKind::ArmUnplug:
+            world.unplugArmed = true;
+            world.unplugOffset = event.param;
+            world.unplugOutage = event.duration;
+            break;
+    }
+}
+
+void applyDue() {
+    while (!world.events.empty() && world.events.begin()->first <= world.now) {
+        const Event event = world.events.begin()->second;
+        world.events.erase(world.events.begin());
+        apply(event);
+    }
+}
+
+void schedule(const u64 at, const Event& event) {
+    world.events.emplace(at, event);
+}
+
+// Every SCard call costs a little time and may be the one an armed service restart fires on
+void enter() {
+    world.stats.calls++;
+    if (degraded()) {
+        world.stats.callsWhileDegraded++;
+    }
+    world.now += callCost;
+    applyDue();
+
+    if (world.restartCountdown > 0 && --world.restartCountdown == 0) {
+        world.stats.faults++;
+        apply({EventKind::ServiceDown});
+        schedule(world.now + world.restartDowntime, {EventKind::ServiceUp});
+    }
+}
+
+LONG checkContext(const SCARDCONTEXT hContext) {
+    const auto it = world.contexts.find(hContext);
+    if (it == world.contexts.end()) {
+        return SCARD_E_INVALID_HANDLE;
+    }
+    if (!serviceAvailable()) {
+        return SCARD_E_SERVICE_STOPPED;
+    }
+    return it->second == world.epoch ? SCARD_S_SUCCESS : SCARD_E_INVALID_HANDLE;
+}
+
+LONG checkCard(const SCARDHANDLE hCard, CardHandle** handle) {
+    const auto it = world.cards.find(hCard);
+    if (it == world.cards.end()) {
+        return SCARD_E_INVALID_HANDLE;
+    }
+    if (!serviceAvailable()) {
+        return SCARD_E_SERVICE_STOPPED;
+    }
+    if (it->second.epoch != world.epoch) {
+        return SCARD_E_INVALID_HANDLE;
+    }
+    if (!world.readerPresent) {
+        return SCARD_E_READER_UNAVAILABLE;
+    }
+    *handle = &it->second;
+    if (it->second.direct) {
+        return SCARD_S_SUCCESS;
+    }
+    if (it->second.reset) {
+        return SCARD_W_RESET_CARD;
+    }
+    if (world.cardTap < 0 || it->second.insertion != world.insertion) {
+        return SCARD_W_REMOVED_CARD;
+    }
+    return SCARD_S_SUCCESS;
+}
+
+DWORD readerStateNow() {
+    if (!world.readerPresent) {
+        return SCARD_STATE_UNKNOWN | SCARD_STATE_IGNORE;
+    }
+    return world.cardTap >= 0 ? SCARD_STATE_PRESENT : SCARD_STATE_EMPTY;
+}
+
+// A status wait on a live context with the reader plugged in ends any pending recovery
+void noteHealthy() {
+    if (world.recoveringSince == never || !serviceAvailable() || !world.readerPresent) {
+        return;
+    }
+    const u64 took = world.now - world.recoveringSince;
+    world.stats.recoveries++;
+    world.stats.totalRecoveryUs += took;
+    world.stats.maxRecoveryUs = std::max(world.stats.maxRecoveryUs, took);
+    world.recoveringSince = never;
+}
+
+void put(BYTE* recv, DWORD* recvLen, const BYTE* data, const DWORD len) {
+    const DWORD n = std::min<DWORD>(len, *recvLen);
+    memcpy(recv, data, n);
+    *recvLen = n;
+}
+
+} // namespace
+
+void reset() {
+    for (void* list : world.readerLists) {
+        free(list);
+    }
+    world = World{};
+}
+
+void setWindowsReaderRemoval(const bool enabled) {
+    world.windowsRemoval = enabled;
+}
+
+u64 now() {
+    return world.now;
+}
+
+void advance(const u64 us) {
+    const u64 target = world.now + us;
+    while (!world.events.empty() && world.events.begin()->first <= target) {
+        world.now = std::max(world.now, world.events.begin()->first);
+        applyDue();
+    }
+    world.now = target;
+}
+
+size_t addTap(const std::string& accessCode, const u64 on, const u64 off, const bool pullDuringAuth, const bool resetDuringTransmit) {
+    world.taps.push_back({accessCode, on, off, pullDuringAuth, resetDuringTransmit});
+    const size_t index = world.taps.size() - 1;
+    schedule(on, {EventKind::CardOn, index});
+    schedule(off, {EventKind::CardOff, index});
+    return index;
+}
+
+void scheduleServiceRestart(const u64 at, const u32 afterCalls, const u64 downtime) {
+    schedule(at, {EventKind::ArmServiceRestart, std::max<u32>(afterCalls, 1), downtime});
+}
+
+void scheduleUnplugDuringWait(const u64 at, const u32 offsetMs, const u64 outage) {
+    schedule(at, {EventKind::ArmUnplug, offsetMs, outage});
+}
+
+void markRead(const std::string& accessCode) {
+    for (auto it = world.taps.rbegin(); it != world.taps.rend(); ++it) {
+        if (it->accessCode == accessCode) {
+            it->read = true;
+            return;
+        }
+    }
+}
+
+bool recoveryPending() {
+    return degraded();
+}
+
+const std::vector<Tap>& taps() {
+    return world.taps;
+}
+
+const Stats& stats() {
+    return world.stats;
+}
+
+} // namespace fake
+
+using namespace fake;
+
+LONG SCardEstablishContext(DWORD, LPCVOID, LPCVOID, SCARDCONTEXT* phContext) {
+    enter();
+    if (!serviceAvailable()) {
+        return SCARD_E_NO_SERVICE;
+    }
+    *phContext = world.nextHandle++;
+    world.contexts[*phContext] = world.epoch;
+    world.stats.liveContexts++;
+    world.stats.maxLiveContexts = std::max(world.stats.maxLiveContexts, world.stats.liveContexts);
+    return SCARD_S_SUCCESS;
+}
+
+LONG SCardReleaseContext(const SCARDCONTEXT hContext) {
+    enter();
+    const LONG lRet = checkContext(hContext);
+    // Client-side resources are freed even when the service is gone
+    if (world.contexts.erase(hContext) > 0) {
+        world.stats.liveContexts--;
+    }
+    return lRet;
+}
+
+LONG SCardListReaders(const SCARDCONTEXT hContext, LPCSTR, LPSTR mszReaders, LPDWORD pcchReaders) {
+    enter();
+    if (const LONG lRet = checkContext(hContext); lRet != SCARD_S_SUCCESS) {
+        return lRet;
+    }
+    if (!world.readerPresent) {
+        return SCARD_E_NO_READERS_AVAILABLE;
+    }
+
+    // Multi-string: the reader name followed by an empty string
+    constexpr DWORD len = sizeof(readerName) + 1;
+    auto* list = static_cast<char*>(calloc(len, 1));
+    memcpy(list, readerName, sizeof(readerName));
+    world.readerLists.insert(list);
+    world.stats.liveReaderNames++;
+    *reinterpret_cast<char**>(mszReaders) = list;
+    *pcchReaders = len;
+    return SCARD_S_SUCCESS;
+}
+
+LONG SCardFreeMemory(SCARDCONTEXT, LPCVOID pvMem) {
+    enter();
+    const auto it = world.readerLists.find(const_cast<void*>(pvMem));
+    if (it == world.readerLists.end()) {
+        return SCARD_E_INVALID_VALUE;
+    }
+    free(*it);
+    world.readerLists.erase(it);
+    world.stats.liveReaderNames--;
+    return SCARD_S_SUCCESS;
+}
+
+LONG SCardGetStatusChange(const SCARDCONTEXT hContext, const DWORD dwTimeout, SCARD_READERSTATE* rgReaderStates, DWORD) {
+    enter();
+    if (rgReaderStates[0].szReader == nullptr) {
+        return SCARD_E_INVALID_VALUE;
+    }
+
+    const u64 deadline = world.now + dwTimeout * ms;
+    while (true) {
+        if (const LONG lRet = checkContext(hContext); lRet != SCARD_S_SUCCESS) {
+            return lRet;
+        }
+
+        const DWORD state = readerStateNow();
+        const DWORD known = rgReaderStates[0].dwCurrentState & (SCARD_STATE_UNKNOWN | SCARD_STATE_IGNORE | SCARD_STATE_EMPTY | SCARD_STATE_PRESENT);
+        if (rgReaderStates[0].dwCurrentState == SCARD_STATE_UNAWARE || known != state) {
+            rgReaderStates[0].dwEventState = state | SCARD_STATE_CHANGED;
+            noteHealthy();
+            return SCARD_S_SUCCESS;
+        }
+
+        if (world.unplugArmed && dwTimeout > 0) {
+            const u64 at = world.now + std::min<u64>(world.unplugOffset, dwTimeout) * ms;
+            world.unplugArmed = false;
+            world.stats.faults++;
+            schedule(at, {EventKind::ReaderOut});
+            schedule(at + world.unplugOutage, {EventKind::ReaderIn});
+        }
+
+        const u64 next = world.events.empty() ? never : world.events.begin()->first;
+        if (next > deadline) {
+            break;
+        }
+        world.now = std::max(world.now, next);
+        applyDue();
+    }
+
+    world.now = deadline;
+    rgReaderStates[0].dwEventState = readerStateNow();
+    noteHealthy();
+    return SCARD_E_TIMEOUT;
+}
+
+LONG SCardConnect(const SCARDCONTEXT hContext, LPCSTR, const DWORD dwShareMode, DWORD, SCARDHANDLE* phCard, LPDWORD pdwActiveProtocol) {
+    enter();
+    if (const LONG lRet = checkContext(hContext); lRet != SCARD_S_SUCCESS) {
+        return lRet;
+    }
+    if (!world.readerPresent) {
+        return SCARD_E_READER_UNAVAILABLE;
+    }
+
+    const bool direct = dwShareMode == SCARD_SHARE_DIRECT;
+    // Windows reports a missing card as removed, which is what the reader's retry logic expects
+    if (!direct && world.cardTap < 0) {
+        return SCARD_W_REMOVED_CARD;
+    }
+
+    *phCard = world.nextHandle++;
+    world.cards[*phCard] = {world.epoch, world.insertion, direct};
+    world.stats.liveCards++;
+    *pdwActiveProtocol = direct ? 0 : SCARD_PROTOCOL_T1;
+    return SCARD_S_SUCCESS;
+}
+
+LONG SCardDisconnect(const SCARDHANDLE hCard, DWORD) {
+    enter();
+    if (world.cards.erase(hCard) == 0) {
+        return SCARD_E_INVALID_HANDLE;
+    }
+    world.stats.liveCards--;
+    return serviceAvailable() ? SCARD_S_SUCCESS : SCARD_E_SERVICE_STOPPED;
+}
+
+LONG SCardStatus(const SCARDHANDLE hCard, LPSTR, LPDWORD, LPDWORD, LPDWORD, LPBYTE pbAtr, LPDWORD pcbAtrLen) {
+    enter();
+    CardHandle* handle = nullptr;
+    if (const LONG lRet = checkCard(hCard, &handle); lRet != SCARD_S_SUCCESS) {
+        return lRet;
+    }
+    put(pbAtr, pcbAtrLen, mifareAtr, sizeof(mifareAtr));
+    return SCARD_S_SUCCESS;
+}
+
+LONG SCardTransmit(const SCARDHANDLE hCard, LPCSCARD_IO_REQUEST, LPCBYTE pbSendBuffer, DWORD, LPSCARD_IO_REQUEST, LPBYTE pbRecvBuffer, LPDWORD pcbRecvLength) {
+    enter();
+    CardHandle* handle = nullptr;
+    if (const LONG lRet = checkCard(hCard, &handle); lRet != SCARD_S_SUCCESS) {
+        return lRet;
+    }
+
+    if (world.resetArmed) {
+        world.resetArmed = false;
+        world.stats.faults++;
+        handle->reset = true;
+        return SCARD_W_RESET_CARD;
+    }
+
+    constexpr BYTE ok[] = {0x90, 0x00};
+    switch (pbSendBuffer[1]) {
+        case 0xCA: {
+            BYTE response[sizeof(uid) + 2];
+            memcpy(response, uid, sizeof(uid));
+            memcpy(response + sizeof(uid), ok, sizeof(ok));
+            put(pbRecvBuffer, pcbRecvLength, response, sizeof(response));
+            return SCARD_S_SUCCESS;
+        }
+        case 0x86:
+            if (world.pullArmed) {
+                world.pullArmed = false;
+                world.stats.faults++;
+                faultCard();
+                world.cardTap = -1;
+                return SCARD_W_REMOVED_CARD;
+            }
+            put(pbRecvBuffer, pcbRecvLength, ok, sizeof(ok));
+            return SCARD_S_SUCCESS;
+        case 0xB0: {
+            // Block 2 holds the access code as BCD in its last 10 bytes
+            BYTE response[18] = {};
+            const std::string& code = world.taps[world.cardTap].accessCode;
+            for (size_t i = 0; i < 10; i++) {
+                response[6 + i] = static_cast<BYTE>(((code[i * 2] - '0') << 4) | (code[i * 2 + 1] - '0'));
+            }
+            memcpy(response + 16, ok, sizeof(ok));
+            put(pbRecvBuffer, pcbRecvLength, response, sizeof(response));
+            return SCARD_S_SUCCESS;
+        }
+        default:
+            put(pbRecvBuffer, pcbRecvLength, ok, sizeof(ok));
+            return SCARD_S_SUCCESS;
+    }
+}
+
+LONG SCardControl(const SCARDHANDLE hCard, DWORD, LPCVOID, DWORD, LPVOID pbRecvBuffer, const DWORD cbRecvLength, LPDWORD lpBytesReturned) {
+    enter();
+    CardHandle* handle = nullptr;
+    if (const LONG lRet = checkCard(hCard, &handle); lRet != SCARD_S_SUCCESS) {
+        return lRet;
+    }
+    constexpr BYTE ok[] = {0x90, 0x00};
+    DWORD len = cbRecvLength;
+    put(static_cast<BYTE*>(pbRecvBuffer), &len, ok, sizeof(ok));
+    *lpBytesReturned = len;
+    return SCARD_S_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <helpers.h>
+#include <string>
+#include <vector>
+
+// Scripted PC/SC layer for the soak harness. Time is virtual (microseconds): every SCard call costs
+// a little of it, sleeps and status waits advance it, and scripted events fire when it reaches them.
+namespace fake {
+
+constexpr u64 ms = 1000;
+constexpr u64 s = 1000 * ms;
+
+struct Tap {
+    std::string accessCode;         // Access code stored on the card, unique per tap.
+    u64 on;                         // Time the card is placed on the reader.
+    u64 off;                        // Time the card is taken off the reader.
+    bool pullDuringAuth;            // Pull the card when the reader authenticates block 2.
+    bool resetDuringTransmit;       // Reset the card on its first APDU.
+    bool faulted = false;           // Whether the tap was hit by a fault that makes it unreadable.
+    bool read = false;              // Whether the reader returned this tap's access code.
+};
+
+struct Stats {
+    i64 liveContexts = 0;           // Established and not yet released contexts.
+    i64 maxLiveContexts = 0;        // Peak of liveContexts.
+    i64 liveReaderNames = 0;        // Auto-allocated reader lists not yet freed.
+    i64 liveCards = 0;              // Connected and not yet disconnected card handles.
+    u64 calls = 0;                  // SCard calls made.
+    u64 callsWhileDegraded = 0;     // SCard calls made while the service or reader was gone or not yet recovered.
+    u64 faults = 0;                 // Faults injected.
+    u64 recoveries = 0;             // Outages the reader recovered from.
+    u64 maxRecoveryUs = 0;          // Longest time from the end of an outage to a healthy status wait.
+    u64 totalRecoveryUs = 0;        // Sum of all recovery times.
+};
+
+void reset();                       // Forget all state, events and statistics, time restarts at 0.
+void setWindowsReaderRemoval(bool enabled); // Unplugging the last reader stops the service, as on Windows 8 and later.
+u64 now();                          // Current virtual time.
+void advance(u64 us);               // Let time pass, firing due events.
+
+size_t addTap(const std::string& accessCode, u64 on, u64 off, bool pullDuringAuth, bool resetDuringTransmit);
+void scheduleServiceRestart(u64 at, u32 afterCalls, u64 downtime);  // Stop the service on the n-th SCard call after `at`.
+void scheduleUnplugDuringWait(u64 at, u32 offsetMs, u64 outage);    // Unplug the reader during the first status wait after `at`.
+
+void markRead(const std::string& accessCode); // Record that the reader returned an access code.
+bool recoveryPending();             // Whether an outage ended without the reader recovering yet.
+const std::vector<Tap>& taps();
+const Stats& stats();
+
+} // namespace fake
@@ -0,0 +1,18 @@
+#include "platform.h"
+#include "fake_pcsc.h"
+
+// Platform shims for the soak harness: sleeping moves the virtual clock instead of blocking
+
+void
+sleepMs (const u32 ms) {
+	fake::advance (ms * fake::ms);
+}
+
+void
+setConsoleColour (int) {}
+
+void
+pressKey (u16) {}
+
+void
+lowerThreadPriority () {}
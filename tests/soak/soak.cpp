@@ -0,0 +1,294 @@
+// Soak harness for the reader recovery paths. Drives SmartCard against the scripted PC/SC layer in
+// fake_pcsc.cpp for hours of virtual time, injecting faults at random points, and fails if the tap
+// success rate, time-to-recover, handle or memory growth regress past their thresholds.
+#include "fake_pcsc.h"
+#include "scard.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+char module[] = "scardreader";
+
+using fake::ms;
+using fake::s;
+
+struct Options {
+    f64 hours = 4.0;                // Virtual duration of the random soak.
+    u64 seed = 1;                   // Seed of the fault schedule.
+    f64 minCleanSuccess = 0.99;     // Taps not hit by a fault that must be read.
+    f64 minSuccess = 0.80;          // All taps that must be read.
+    u64 maxRecoveryMs = 3000;       // Longest allowed time from the end of an outage to a healthy reader.
+    f64 maxCallsPerSecond = 20.0;   // SCard calls per virtual second while degraded, catches busy loops.
+    i64 maxRssGrowthKb = 4096;      // Resident memory the soak may grow by.
+    bool verbose = false;           // Keep the reader's console output.
+};
+
+struct Check {
+    int failures = 0;
+
+    void expect(const bool ok, const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        fputs(ok ? "  ok    " : "  FAIL  ", stderr);
+        vfprintf(stderr, format, args);
+        fputc('\n', stderr);
+        va_end(args);
+        if (!ok) {
+            failures++;
+        }
+    }
+};
+
+i64 residentKb() {
+    long pages = 0, resident = 0;
+    if (FILE* fp = fopen("/proc/self/statm", "r")) {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+std::string accessCodeFor(const size_t tap) {
+    char code[21];
+    snprintf(code, sizeof(code), "300%017zu", tap);
+    return code;
+}
+
+// Run the reader loop like readerPollThread does until the virtual clock reaches `end`
+bool drive(SmartCard& sCard, const u64 end, Check& check) {
+    int stalls = 0;
+    while (fake::now() < end) {
+        const u64 before = fake::now();
+        sCard.update();
+        if (!sCard.cardInfo.accessCode.empty()) {
+            fake::markRead(sCard.cardInfo.accessCode);
+        }
+
+        // Every update either waits, sleeps or calls into PC/SC, so time must move
+        stalls = fake::now() == before ? stalls + 1 : 0;
+        if (stalls > 1000) {
+            check.expect(false, "reader loop keeps running without advancing time at %.1f s", fake::now() / static_cast<f64>(s));
+            return false;
+        }
+    }
+    return true;
+}
+
+// Handles must not outlive the reader, and at most one of each may be live while it runs
+void checkHandles(const char* when, const i64 contexts, const i64 readerNames, const i64 cards, Check& check) {
+    const auto& stats = fake::stats();
+    check.expect(stats.liveContexts <= contexts, "%s: %lld live contexts (max %lld)", when, static_cast<long long>(stats.liveContexts), static_cast<long long>(contexts));
+    check.expect(stats.liveReaderNames <= readerNames, "%s: %lld live reader lists (max %lld)", when, static_cast<long long>(stats.liveReaderNames),
+                 static_cast<long long>(readerNames));
+    check.expect(stats.liveCards <= cards, "%s: %lld live card handles (max %lld)", when, static_cast<long long>(stats.liveCards), static_cast<long long>(cards));
+}
+
+void checkRecovery(const Options& opts, Check& check) {
+    const auto& stats = fake::stats();
+    check.expect(!fake::recoveryPending(), "reader recovered from the last outage");
+    check.expect(stats.maxRecoveryUs <= opts.maxRecoveryMs * ms, "max time-to-recover %llu ms (max %llu ms)", static_cast<unsigned long long>(stats.maxRecoveryUs / ms),
+                 static_cast<unsigned long long>(opts.maxRecoveryMs));
+}
+
+int runScenario(const std::string& name, const bool windowsRemoval, const std::function<void(Check&)>& body) {
+    fprintf(stderr, "%s (%s reader removal)\n", name.c_str(), windowsRemoval ? "Windows" : "pcsc-lite");
+    fake::reset();
+    fake::setWindowsReaderRemoval(windowsRemoval);
+    Check check;
+    body(check);
+    checkHandles("after the reader is destroyed", 0, 0, 0, check);
+    return check.failures;
+}
+
+int unplugThenReplug(const Options& opts, const bool windowsRemoval) {
+    return runScenario("unplug then replug", windowsRemoval, [&](Check& check) {
+        const size_t before = fake::addTap(accessCodeFor(0), 2 * s, 3 * s, false, false);
+        fake::scheduleUnplugDuringWait(4 * s, 100, 20 * s);
+        const size_t during = fake::addTap(accessCodeFor(1), 10 * s, 11 * s, false, false);
+        const size_t after = fake::addTap(accessCodeFor(2), 30 * s, 31500 * ms, false, false);
+
+        SmartCard sCard;
+        check.expect(sCard.initialize(), "reader initialized");
+        if (!drive(sCard, 40 * s, check)) {
+            return;
+        }
+
+        const auto& taps = fake::taps();
+        const auto& stats = fake::stats();
+        check.expect(taps[before].read, "tap before the unplug read");
+        check.expect(!taps[during].read, "tap while unplugged not read");
+        check.expect(taps[after].read, "tap after the replug read");
+        check.expect(stats.recoveries == 1, "%llu recoveries (expected 1)", static_cast<unsigned long long>(stats.recoveries));
+        checkRecovery(opts, check);
+
+        // The outage lasts 20 s, backing off keeps the calls made during it to a handful per second
+        const f64 rate = stats.callsWhileDegraded / 20.0;
+        check.expect(rate <= opts.maxCallsPerSecond, "%.1f calls per second while degraded (max %.1f)", rate, opts.maxCallsPerSecond);
+        checkHandles("while running", 1, 1, 0, check);
+    });
+}
+
+int serviceRestart(const Options& opts) {
+    return runScenario("service restart", false, [&](Check& check) {
+        fake::scheduleServiceRestart(4 * s, 1, 5 * s);
+        const size_t after = fake::addTap(accessCodeFor(0), 15 * s, 16500 * ms, false, false);
+
+        SmartCard sCard;
+        check.expect(sCard.initialize(), "reader initialized");
+        if (!drive(sCard, 20 * s, check)) {
+            return;
+        }
+
+        const auto& stats = fake::stats();
+        check.expect(fake::taps()[after].read, "tap after the restart read");
+        check.expect(stats.recoveries == 1, "%llu recoveries (expected 1)", static_cast<unsigned long long>(stats.recoveries));
+        checkRecovery(opts, check);
+        checkHandles("while running", 1, 1, 0, check);
+    });
+}
+
+int cardFaults() {
+    return runScenario("card pulled mid-auth and card reset", false, [&](Check& check) {
+        const size_t pulled = fake::addTap(accessCodeFor(0), 2 * s, 4 * s, true, false);
+        const size_t next = fake::addTap(accessCodeFor(1), 6 * s, 7500 * ms, false, false);
+        const size_t reset = fake::addTap(accessCodeFor(2), 10 * s, 11500 * ms, false, true);
+
+        SmartCard sCard;
+        check.expect(sCard.initialize(), "reader initialized");
+        if (!drive(sCard, 15 * s, check)) {
+            return;
+        }
+
+        const auto& taps = fake::taps();
+        check.expect(!taps[pulled].read, "tap pulled mid-auth not read");
+        check.expect(taps[next].read, "tap after the pulled one read");
+        check.expect(taps[reset].read, "tap reset mid-read recovered and read");
+        checkHandles("while running", 1, 1, 0, check);
+    });
+}
+
+int soak(const Options& opts, const bool windowsRemoval) {
+    char name[64];
+    snprintf(name, sizeof(name), "random soak, %.1f h, seed %llu", opts.hours, static_cast<unsigned long long>(opts.seed));
+    return runScenario(name, windowsRemoval, [&](Check& check) {
+        std::mt19937_64 rng(opts.seed);
+        auto chance = [&](const f64 p) { return std::uniform_real_distribution<f64>(0.0, 1.0)(rng) < p; };
+        auto between = [&](const u64 lo, const u64 hi) { return std::uniform_int_distribution<u64>(lo, hi)(rng); };
+
+        // Taps every few seconds, each with a small chance of one of the faults
+        const u64 end = static_cast<u64>(opts.hours * 3600.0) * s;
+        u64 t = 2 * s;
+        for (size_t i = 0; t < end; i++) {
+            const u64 on = t + between(2 * s, 6 * s);
+            const u64 off = on + between(1 * s, 3 * s);
+            fake::addTap(accessCodeFor(i), on, off, chance(0.05), chance(0.03));
+            if (chance(0.02)) {
+                fake::scheduleServiceRestart(between(t, off), static_cast<u32>(between(1, 30)), between(1 * s, 10 * s));
+            }
+            if (chance(0.02)) {
+                fake::scheduleUnplugDuringWait(between(t, off), static_cast<u32>(between(0, 500)), between(2 * s, 30 * s));
+            }
+            t = off;
+        }
+
+        SmartCard sCard;
+        check.expect(sCard.initialize(), "reader initialized");
+
+        // Warm up for a few minutes before taking the memory baseline
+        if (!drive(sCard, std::min<u64>(end, 600 * s), check)) {
+            return;
+        }
+        const i64 baseline = residentKb();
+        if (!drive(sCard, end + 60 * s, check)) {
+            return;
+        }
+        const i64 growth = residentKb() - baseline;
+
+        size_t read = 0, clean = 0, cleanRead = 0;
+        for (const auto& tap : fake::taps()) {
+            read += tap.read;
+            clean += !tap.faulted;
+            cleanRead += !tap.faulted && tap.read;
+        }
+        const auto& stats = fake::stats();
+        const size_t total = fake::taps().size();
+        fprintf(stderr, "  %zu taps, %zu hit by faults, %llu faults injected, %llu recoveries, mean time-to-recover %llu ms\n", total, total - clean,
+                static_cast<unsigned long long>(stats.faults), static_cast<unsigned long long>(stats.recoveries),
+                static_cast<unsigned long long>(stats.recoveries ? stats.totalRecoveryUs / stats.recoveries / ms : 0));
+
+        const f64 cleanRate = clean ? static_cast<f64>(cleanRead) / clean : 1.0;
+        const f64 rate = total ? static_cast<f64>(read) / total : 1.0;
+        check.expect(cleanRate >= opts.minCleanSuccess, "success rate of taps without faults %.4f (min %.4f)", cleanRate, opts.minCleanSuccess);
+        check.expect(rate >= opts.minSuccess, "success rate of all taps %.4f (min %.4f)", rate, opts.minSuccess);
+        check.expect(stats.recoveries > 0, "outages were injected and recovered from");
+        checkRecovery(opts, check);
+        check.expect(stats.maxLiveContexts <= 1, "peak of %lld live contexts (max 1)", static_cast<long long>(stats.maxLiveContexts));
+        check.expect(growth <= opts.maxRssGrowthKb, "resident memory grew by %lld KiB (max %lld KiB)", static_cast<long long>(growth),
+                     static_cast<long long>(opts.maxRssGrowthKb));
+        checkHandles("while running", 1, 1, 0, check);
+    });
+}
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--hours H] [--seed N] [--min-clean-success R] [--min-success R] [--max-recovery-ms MS] [--max-calls-per-second N] [--max-rss-growth-kb KB] "
+            "[--verbose]\n",
+            argv0);
+}
+
+int main(const int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(arg, "--verbose") == 0) {
+            opts.verbose = true;
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(arg, "--hours") == 0) opts.hours = atof(value);
+        else if (strcmp(arg, "--seed") == 0) opts.seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--min-clean-success") == 0) opts.minCleanSuccess = atof(value);
+        else if (strcmp(arg, "--min-success") == 0) opts.minSuccess = atof(value);
+        else if (strcmp(arg, "--max-recovery-ms") == 0) opts.maxRecoveryMs = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--max-calls-per-second") == 0) opts.maxCallsPerSecond = atof(value);
+        else if (strcmp(arg, "--max-rss-growth-kb") == 0) opts.maxRssGrowthKb = strtoll(value, nullptr, 10);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+
+    // The reader logs every tap and fault, keep stderr for the report
+    if (!opts.verbose && !freopen("/dev/null", "w", stdout)) {
+        return 2;
+    }
+
+    int failures = 0;
+    for (const bool windowsRemoval : {false, true}) {
+        failures += unplugThenReplug(opts, windowsRemoval);
+    }
+    failures += serviceRestart(opts);
+    failures += cardFaults();
+    for (const bool windowsRemoval : {false, true}) {
+        failures += soak(opts, windowsRemoval);
+    }
+
+    fprintf(stderr, failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}